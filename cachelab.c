@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 #include "cachelab.h"
 #include <time.h>
 
@@ -74,6 +75,10 @@ void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
                            char* desc)
 {
     func_list[func_counter].func_ptr = trans;
+    func_list[func_counter].inplace_ptr = NULL;
+    func_list[func_counter].typed_ptr = NULL;
+    func_list[func_counter].elem_size = sizeof(int);
+    func_list[func_counter].layout = LAYOUT_ROW_MAJOR;
     func_list[func_counter].description = desc;
     func_list[func_counter].correct = 0;
     func_list[func_counter].num_hits = 0;
@@ -81,3 +86,165 @@ void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
     func_list[func_counter].num_evictions =0;
     func_counter++;
 }
+
+/* 
+ * registerInPlaceTransFunction - Add the given in-place trans function
+ *     into your list of functions to be tested
+ */
+void registerInPlaceTransFunction(void (*trans)(int M, int N, int[N][M]), 
+                                  char* desc)
+{
+    registerTransFunction(NULL, desc);
+    func_list[func_counter-1].inplace_ptr = trans;
+}
+
+/* 
+ * registerLayoutTransFunction - Add the given trans function, which
+ *     works on A and B stored in the given layout, into your list of
+ *     functions to be tested
+ */
+void registerLayoutTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]), 
+                                 char* desc, int layout)
+{
+    registerTransFunction(trans, desc);
+    func_list[func_counter-1].layout = layout;
+}
+
+/* 
+ * registerTypedTransFunction - Add the given trans function, which
+ *     works on elements of elem_size bytes, into your list of functions
+ *     to be tested
+ */
+void registerTypedTransFunction(void (*trans)(int M, int N, void*, void*), 
+                                char* desc, int elem_size)
+{
+    registerTransFunction(NULL, desc);
+    func_list[func_counter-1].typed_ptr = trans;
+    func_list[func_counter-1].elem_size = elem_size;
+}
+
+/* 
+ * morton_spread - Spread the bits of x out to the even bit positions
+ */
+static long morton_spread(long x)
+{
+    long z = 0;
+    int bit;
+    for (bit = 0; (x >> bit) != 0; bit++)
+        z |= ((x >> bit) & 1) << (2 * bit);
+    return z;
+}
+
+/* 
+ * layoutSize - Number of ints a rows x cols matrix occupies in the
+ *     given layout, padding included
+ */
+long layoutSize(int layout, int rows, int cols)
+{
+    long side;
+
+    switch (layout) {
+    case LAYOUT_TILED:
+        return (long) (rows + LAYOUT_TILE - 1) / LAYOUT_TILE
+            * ((cols + LAYOUT_TILE - 1) / LAYOUT_TILE) * LAYOUT_TILE * LAYOUT_TILE;
+    case LAYOUT_MORTON:
+        /* The last tile in Z order is the bottom-right one */
+        side = (morton_spread((rows - 1) / LAYOUT_TILE) << 1)
+            | morton_spread((cols - 1) / LAYOUT_TILE);
+        return (side + 1) * LAYOUT_TILE * LAYOUT_TILE;
+    default:
+        return (long) rows * cols;
+    }
+}
+
+/* 
+ * layoutOffset - Position of element [r][c] of a rows x cols matrix in
+ *     the given layout
+ */
+long layoutOffset(int layout, int rows, int cols, int r, int c)
+{
+    long tile;
+
+    switch (layout) {
+    case LAYOUT_TILED:
+        tile = (long) (r / LAYOUT_TILE) * ((cols + LAYOUT_TILE - 1) / LAYOUT_TILE)
+            + c / LAYOUT_TILE;
+        break;
+    case LAYOUT_MORTON:
+        tile = (morton_spread(r / LAYOUT_TILE) << 1) | morton_spread(c / LAYOUT_TILE);
+        break;
+    default:
+        return (long) r * cols + c;
+    }
+    return tile * LAYOUT_TILE * LAYOUT_TILE
+        + (r % LAYOUT_TILE) * LAYOUT_TILE + c % LAYOUT_TILE;
+}
+
+/* 
+ * layoutCoords - Element held at position off of a rows x cols matrix
+ *     in the given layout. Returns 0 if off is padding.
+ */
+int layoutCoords(int layout, int rows, int cols, long off, int *r, int *c)
+{
+    long tile = off / (LAYOUT_TILE * LAYOUT_TILE), tr, tc;
+    int bit;
+
+    switch (layout) {
+    case LAYOUT_TILED:
+        tr = tile / ((cols + LAYOUT_TILE - 1) / LAYOUT_TILE);
+        tc = tile % ((cols + LAYOUT_TILE - 1) / LAYOUT_TILE);
+        break;
+    case LAYOUT_MORTON:
+        tr = tc = 0;
+        for (bit = 0; (tile >> (2 * bit)) != 0; bit++) {
+            tc |= ((tile >> (2 * bit)) & 1) << bit;
+            tr |= ((tile >> (2 * bit + 1)) & 1) << bit;
+        }
+        break;
+    default:
+        *r = off / cols;
+        *c = off % cols;
+        return off < (long) rows * cols;
+    }
+    *r = tr * LAYOUT_TILE + (off / LAYOUT_TILE) % LAYOUT_TILE;
+    *c = tc * LAYOUT_TILE + off % LAYOUT_TILE;
+    return *r < rows && *c < cols;
+}
+
+/* 
+ * toLayout - Convert a row-major rows x cols matrix into the given
+ *     layout. Each tile row is a contiguous run in both, so the copy
+ *     goes a run at a time. Padding is zeroed.
+ */
+void toLayout(int layout, int rows, int cols, int *src, int *dst)
+{
+    int r, c, len;
+
+    memset(dst, 0, sizeof(int) * layoutSize(layout, rows, cols));
+    for (r = 0; r < rows; r++) {
+        for (c = 0; c < cols; c += len) {
+            len = layout == LAYOUT_ROW_MAJOR ? cols - c
+                : (c + LAYOUT_TILE < cols ? LAYOUT_TILE : cols - c);
+            memcpy(&dst[layoutOffset(layout, rows, cols, r, c)],
+                   &src[(long) r * cols + c], sizeof(int) * len);
+        }
+    }
+}
+
+/* 
+ * fromLayout - Convert a rows x cols matrix in the given layout back
+ *     into row-major order
+ */
+void fromLayout(int layout, int rows, int cols, int *src, int *dst)
+{
+    int r, c, len;
+
+    for (r = 0; r < rows; r++) {
+        for (c = 0; c < cols; c += len) {
+            len = layout == LAYOUT_ROW_MAJOR ? cols - c
+                : (c + LAYOUT_TILE < cols ? LAYOUT_TILE : cols - c);
+            memcpy(&dst[(long) r * cols + c],
+                   &src[layoutOffset(layout, rows, cols, r, c)], sizeof(int) * len);
+        }
+    }
+}
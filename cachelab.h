@@ -7,8 +7,35 @@
 
 #define MAX_TRANS_FUNCS 100
 
+/* 
+ * Binary trace format written by tracesynth and read by csim: the
+ * TRACE_MAGIC header followed by TRACE_REC_SIZE-byte records, each an
+ * 8-byte little-endian address, the op character ('L', 'S', 'M' or 'I')
+ * and the access size in bytes.
+ */
+#define TRACE_MAGIC "CLTRACE1"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_REC_SIZE 10
+
+/*
+ * Storage layouts a transpose function can take A and B in. The tiled
+ * layouts split a matrix into LAYOUT_TILE x LAYOUT_TILE tiles, each
+ * stored contiguously in row-major order and padded out at the right
+ * and bottom edges. LAYOUT_TILED stores the tiles in row-major order;
+ * LAYOUT_MORTON stores them along the Z-order curve of the smallest
+ * power-of-two square of tiles that covers the matrix.
+ */
+#define LAYOUT_ROW_MAJOR 0
+#define LAYOUT_TILED 1
+#define LAYOUT_MORTON 2
+#define LAYOUT_TILE 8
+
 typedef struct trans_func{
   void (*func_ptr)(int M,int N,int[N][M],int[M][N]);
+  void (*inplace_ptr)(int M,int N,int[N][M]); /* set instead of func_ptr for in-place functions */
+  void (*typed_ptr)(int M,int N,void*,void*); /* set instead of func_ptr for other element types */
+  int elem_size;  /* bytes per element of A and B, sizeof(int) unless typed_ptr is set */
+  int layout;  /* LAYOUT_* storage of A and B, LAYOUT_ROW_MAJOR for most functions */
   char* description;
   char correct;
   unsigned int num_hits;
@@ -34,4 +61,48 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 void registerTransFunction(
     void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc);
 
+/* 
+ * Add the given in-place function to the function list. On return the
+ * storage of A must hold A^T laid out as an M-row by N-column matrix.
+ */
+void registerInPlaceTransFunction(
+    void (*trans)(int M,int N,int[N][M]), char* desc);
+
+/* 
+ * Add the given function to the function list as one that takes A and
+ * B stored in the given LAYOUT_*. The test programs convert A into the
+ * layout before the run and B back out of it afterwards.
+ */
+void registerLayoutTransFunction(
+    void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc, int layout);
+
+/* Largest element, in bytes, a typed function may use */
+#define MAX_ELEM_SIZE 16
+
+/* 
+ * Add the given function, which transposes an N x M matrix of
+ * elem_size-byte elements at A into the M x N matrix at B, to the
+ * function list. The test programs compare elements byte by byte.
+ */
+void registerTypedTransFunction(
+    void (*trans)(int M,int N,void*,void*), char* desc, int elem_size);
+
+/* Number of ints a rows x cols matrix occupies in the given layout */
+long layoutSize(int layout, int rows, int cols);
+
+/* Position of element [r][c] of a rows x cols matrix in the given layout */
+long layoutOffset(int layout, int rows, int cols, int r, int c);
+
+/* 
+ * Element held at position off of a rows x cols matrix in the given
+ * layout. Returns 0 if off is padding.
+ */
+int layoutCoords(int layout, int rows, int cols, long off, int *r, int *c);
+
+/* Convert a rows x cols matrix from row-major order into the layout */
+void toLayout(int layout, int rows, int cols, int *src, int *dst);
+
+/* Convert a rows x cols matrix from the layout back to row-major order */
+void fromLayout(int layout, int rows, int cols, int *src, int *dst);
+
 #endif /* CACHELAB_TOOLS_H */
@@ -5,13 +5,46 @@
 #     function. It uses ./test-csim to check the correctness of the
 #     simulator and it runs ./test-trans on three different sized
 #     matrices (32x32, 64x64, and 61x67) to test the correctness and
-#     performance of the transpose function.
+#     performance of the transpose function. The four runs go in
+#     parallel, each in its own scratch directory, since test-csim and
+#     test-trans all write .csim_results, .marker and trace.fN in their
+#     working directory.
 #
 import subprocess;
 import re;
 import os;
 import sys;
 import optparse;
+import tempfile;
+import shutil;
+
+# Programs and data the test programs expect in their working directory
+scratch_files = ["csim", "csim-ref", "test-csim", "test-trans", "tracegen",
+                 "traces"]
+
+#
+# startTest - start cmd in a fresh scratch directory that links to the
+# programs and traces in the current directory. Returns the process and
+# the directory, which the caller removes once the process is done.
+#
+def startTest(cmd):
+    scratch = tempfile.mkdtemp(prefix="cachelab-")
+    for name in scratch_files:
+        if os.path.exists(name):
+            os.symlink(os.path.abspath(name), os.path.join(scratch, name))
+    p = subprocess.Popen(cmd, shell=True, cwd=scratch,
+                         stdout=subprocess.PIPE)
+    return (p, scratch)
+
+#
+# finishTest - wait for a test started by startTest, clean up its
+# scratch directory and return its output
+#
+def finishTest(test):
+    (p, scratch) = test
+    stdout_data = p.communicate()[0]
+    shutil.rmtree(scratch, ignore_errors=True)
+    return stdout_data
 
 #
 # computeMissScore - compute the score depending on the number of
@@ -47,12 +80,16 @@ def main():
     opts, args = p.parse_args()
     autograde = opts.autograde
 
+    # Start all of the tests at once; the driver takes as long as the slowest
+    test_csim = startTest("./test-csim")
+    test32 = startTest("./test-trans -M 32 -N 32 | grep TEST_TRANS_RESULTS")
+    test64 = startTest("./test-trans -M 64 -N 64 | grep TEST_TRANS_RESULTS")
+    test61 = startTest("./test-trans -M 61 -N 67 | grep TEST_TRANS_RESULTS")
+
     # Check the correctness of the cache simulator
     print "Part A: Testing cache simulator"
     print "Running ./test-csim"
-    p = subprocess.Popen("./test-csim", 
-                         shell=True, stdout=subprocess.PIPE)
-    stdout_data = p.communicate()[0]
+    stdout_data = finishTest(test_csim)
 
     # Emit the output from test-csim
     stdout_data = re.split('\n', stdout_data)
@@ -66,23 +103,17 @@ def main():
     # 32x32 transpose
     print "Part B: Testing transpose function"
     print "Running ./test-trans -M 32 -N 32"
-    p = subprocess.Popen("./test-trans -M 32 -N 32 | grep TEST_TRANS_RESULTS", 
-                         shell=True, stdout=subprocess.PIPE)
-    stdout_data = p.communicate()[0]
+    stdout_data = finishTest(test32)
     result32 = re.findall(r'(\d+)', stdout_data)
     
     # 64x64 transpose
     print "Running ./test-trans -M 64 -N 64"
-    p = subprocess.Popen("./test-trans -M 64 -N 64 | grep TEST_TRANS_RESULTS", 
-                         shell=True, stdout=subprocess.PIPE)
-    stdout_data = p.communicate()[0]
+    stdout_data = finishTest(test64)
     result64 = re.findall(r'(\d+)', stdout_data)
     
     # 61x67 transpose
     print "Running ./test-trans -M 61 -N 67"
-    p = subprocess.Popen("./test-trans -M 61 -N 67 | grep TEST_TRANS_RESULTS", 
-                         shell=True, stdout=subprocess.PIPE)
-    stdout_data = p.communicate()[0]
+    stdout_data = finishTest(test61)
     result61 = re.findall(r'(\d+)', stdout_data)
     
     # Compute the scores for each step
@@ -0,0 +1,243 @@
+/*
+ * mmtrans.c - Out-of-core matrix transpose over memory-mapped files
+ *
+ * Transposes an N x M matrix of ints stored row-major in a file into an
+ * M x N matrix in another file, for matrices too large to load. Both
+ * files are mapped and the work is cut into column panels of A, which
+ * are row panels of B: each panel is a contiguous stretch of B, so B is
+ * written front to back and can be flushed and dropped behind the
+ * kernel, while the row segments of A for the next panel are prefetched
+ * with madvise. Inside a panel the tiles are visited by
+ * transpose_blocked from trans.c, the same code the transpose_panels
+ * kernel runs under the simulator.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cachelab.h"
+
+extern void transpose_blocked(int M, int N, int A[N][M], int B[M][N],
+                              int r0, int r1, int c0, int c1, int tile);
+
+/* Globals set on the command line */
+static int M = 0, N = 0;        /* columns and rows of A */
+static int panel = 0;           /* columns of A per panel (default one page) */
+static int tile = 16;           /* tile edge (one 64-byte line of ints) */
+static char *in_file = NULL, *out_file = NULL;
+static int generate = 0, verify = 0;
+
+static long page_size;
+
+/*
+ * now - Wall clock time in seconds
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * advise - madvise a byte range of a mapping, widened to whole pages
+ */
+static void advise(char *map, size_t lo, size_t hi, int advice)
+{
+    size_t start = lo & ~(size_t) (page_size - 1);
+
+    if (hi > start)
+        madvise(map + start, hi - start, advice);
+}
+
+/*
+ * map_file - Open and map a file of the given size. When create is set
+ *     the file is created or truncated to size and mapped writable.
+ */
+static char *map_file(const char *path, size_t size, int create)
+{
+    struct stat st;
+    char *map;
+    int fd;
+
+    fd = open(path, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+    if (fd < 0) {
+        perror(path);
+        exit(1);
+    }
+    if (create) {
+        if (ftruncate(fd, size) < 0) {
+            perror("mmtrans: ftruncate");
+            exit(1);
+        }
+    } else if (fstat(fd, &st) < 0 || (size_t) st.st_size < size) {
+        printf("Error: %s holds fewer than %d x %d ints\n", path, N, M);
+        exit(1);
+    }
+
+    map = mmap(NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ,
+               MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmtrans: mmap");
+        exit(1);
+    }
+    close(fd);
+    return map;
+}
+
+/*
+ * prefetch_panel - Ask for the row segments of A that panel [c0, c1) reads
+ */
+static void prefetch_panel(char *a, int c0, int c1)
+{
+    size_t row_bytes = (size_t) M * sizeof(int);
+    int n;
+
+    for (n = 0; n < N; n++)
+        advise(a, n * row_bytes + c0 * sizeof(int),
+               n * row_bytes + c1 * sizeof(int), MADV_WILLNEED);
+}
+
+/*
+ * generate_input - Write A[n][m] = n * M + m to the input file
+ */
+static void generate_input(void)
+{
+    size_t size = (size_t) M * N * sizeof(int);
+    int *a = (int *) map_file(in_file, size, 1);
+    size_t i;
+
+    for (i = 0; i < (size_t) M * N; i++)
+        a[i] = (int) i;
+    munmap(a, size);
+}
+
+/*
+ * check_output - Compare B against A^T. Walks B in order and A by
+ *     columns, so this is slow on matrices that do not fit in memory.
+ */
+static int check_output(int *a, int *b)
+{
+    size_t m, n;
+
+    for (m = 0; m < (size_t) M; m++)
+        for (n = 0; n < (size_t) N; n++)
+            if (b[m * N + n] != a[n * M + m]) {
+                printf("Error: B[%zu][%zu] != A[%zu][%zu]\n", m, n, n, m);
+                return 0;
+            }
+    return 1;
+}
+
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-hgv] -M <cols> -N <rows> -i <A file> -o <B file> [-P <cols>] [-T <n>]\n",
+           argv[0]);
+    printf("Options:\n");
+    printf("  -h              Print this help message.\n");
+    printf("  -M <cols>       Columns of A (rows of B)\n");
+    printf("  -N <rows>       Rows of A (columns of B)\n");
+    printf("  -i <file>       Input matrix A, N x M ints in row-major order\n");
+    printf("  -o <file>       Output matrix B, created or overwritten\n");
+    printf("  -P <cols>       Columns of A per panel (default one page of ints)\n");
+    printf("  -T <n>          Tile edge inside a panel (default 16)\n");
+    printf("  -g              Fill the input file with a test matrix first\n");
+    printf("  -v              Check B against A after the transpose\n");
+    printf("Example: %s -g -v -M 8192 -N 8192 -i a.mat -o b.mat\n", argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    int c, c0, c1;
+    size_t size, row_bytes;
+    char *a, *b;
+    double start, secs;
+    struct stat in_st, out_st;
+
+    page_size = sysconf(_SC_PAGESIZE);
+
+    while ((c = getopt(argc, argv, "hgvM:N:i:o:P:T:")) != -1) {
+        switch (c) {
+        case 'M': M = atoi(optarg); break;
+        case 'N': N = atoi(optarg); break;
+        case 'i': in_file = optarg; break;
+        case 'o': out_file = optarg; break;
+        case 'P': panel = atoi(optarg); break;
+        case 'T': tile = atoi(optarg); break;
+        case 'g': generate = 1; break;
+        case 'v': verify = 1; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (panel == 0)
+        panel = page_size / sizeof(int);
+    if (M <= 0 || N <= 0 || panel <= 0 || tile <= 0 || !in_file || !out_file) {
+        printf("Error: Missing or invalid arguments\n");
+        usage(argv);
+        exit(1);
+    }
+
+    if (generate)
+        generate_input();
+
+    // Opening B truncates it, which would wipe A if both name the same file
+    if (stat(in_file, &in_st) == 0 && stat(out_file, &out_st) == 0 &&
+        in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino) {
+        printf("Error: %s and %s are the same file\n", in_file, out_file);
+        exit(1);
+    }
+
+    size = (size_t) M * N * sizeof(int);
+    row_bytes = (size_t) N * sizeof(int);
+    a = map_file(in_file, size, 0);
+    b = map_file(out_file, size, 1);
+
+    // A is read a page-wide column panel at a time, so the kernel's readahead
+    // along a row would only pull in pages for later panels
+    madvise(a, size, MADV_RANDOM);
+    madvise(b, size, MADV_SEQUENTIAL);
+
+    start = now();
+    prefetch_panel(a, 0, panel < M ? panel : M);
+    for (c0 = 0; c0 < M; c0 = c1) {
+        c1 = c0 + panel < M ? c0 + panel : M;
+        if (c1 < M)
+            prefetch_panel(a, c1, c1 + panel < M ? c1 + panel : M);
+
+        transpose_blocked(M, N, (int (*)[M]) a, (int (*)[N]) b, 0, N, c0, c1, tile);
+
+        // Rows [c0, c1) of B are done: start their write-back and drop them
+        msync(b + ((c0 * row_bytes) & ~(size_t) (page_size - 1)),
+              c1 * row_bytes - ((c0 * row_bytes) & ~(size_t) (page_size - 1)), MS_ASYNC);
+        advise(b, c0 * row_bytes, c1 * row_bytes & ~(size_t) (page_size - 1),
+               MADV_DONTNEED);
+    }
+    msync(b, size, MS_SYNC);
+    secs = now() - start;
+
+    printf("mmtrans: %dx%d panel:%d tile:%d bytes:%zu time:%.3fs throughput:%.3f GB/s\n",
+           N, M, panel, tile, 2 * size, secs, 2 * size / secs / 1e9);
+
+    if (verify) {
+        if (!check_output((int *) a, (int *) b))
+            exit(1);
+        printf("mmtrans: verified\n");
+    }
+
+    munmap(a, size);
+    munmap(b, size);
+    return 0;
+}
@@ -3,6 +3,7 @@
  *     student's transpose functions and records the results for their
  *     official submitted version as well.
  */
+#define _GNU_SOURCE /* for syscall() */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,6 +15,11 @@
 #include "cachelab.h"
 #include <sys/wait.h> // fir WEXITSTATUS
 #include <limits.h> // for INT_MAX
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <emmintrin.h> // for _mm_clflush
 
 /* Maximum array dimension */
 #define MAXN 256
@@ -32,6 +38,36 @@ extern int func_counter;
 /* Globals set on the command line */
 static int M = 0;
 static int N = 0;
+static int grid = 0;   /* sweep the geometry grid below for every function */
+static int keep_instr = 0; /* keep lackey I records in trace.fN for csim --icache */
+static int rank = 0;   /* rank the functions by csim's estimated cycles */
+static int missmap = 0; /* write a per-element miss map for every function */
+static int bench = 0;  /* run every function natively and read hardware counters */
+
+/* Runs per function in the -p benchmark; each starts with A and B flushed */
+#define BENCH_RUNS 100
+
+/* Hardware counters read by the -p benchmark, fd -1 when unavailable */
+enum { CTR_CYCLES, CTR_L1D, CTR_LLC, NUM_CTRS };
+static int ctr_fd[NUM_CTRS];
+
+/* Native copies of tracegen's matrices for the -p benchmark, with room for
+   MAXN x MAXN elements of MAX_ELEM_SIZE bytes */
+static int bench_A[MAXN * MAX_ELEM_SIZE / sizeof(int)][MAXN] __attribute__((aligned(64)));
+static int bench_B[MAXN * MAX_ELEM_SIZE / sizeof(int)][MAXN] __attribute__((aligned(64)));
+static int bench_rows[MAXN * MAXN];
+
+/* Base addresses of tracegen's A and B, read from .marker */
+static unsigned long long int a_base, b_base;
+
+/* Estimated cycles per function from csim's timing model, -1 if unknown */
+static double est_cycles[MAX_TRANS_FUNCS];
+
+/* Cache geometries swept by the -g report */
+static const unsigned int grid_s[] = {3, 4, 5, 6};
+static const unsigned int grid_E[] = {1, 2, 4};
+static const unsigned int grid_b[] = {4, 5, 6};
+#define GRID_LEN(a) (sizeof(a) / sizeof((a)[0]))
 
 /* The correctness and performance for the submitted transpose function */
 struct results {
@@ -41,6 +77,386 @@ struct results {
 };
 static struct results results = {-1, 0, INT_MAX};
 
+/*
+ * cmp_addr - qsort comparator for block addresses
+ */
+static int cmp_addr(const void *x, const void *y)
+{
+    unsigned long long int a = *(const unsigned long long int *) x;
+    unsigned long long int c = *(const unsigned long long int *) y;
+    return (a > c) - (a < c);
+}
+
+/*
+ * count_blocks - Number of distinct 2^b-byte blocks touched by addrs,
+ *     i.e. the compulsory-miss lower bound for any cache with that
+ *     block size. Sorts a scratch copy of the addresses.
+ */
+static unsigned int count_blocks(unsigned long long int *addrs,
+                                 unsigned long long int *scratch,
+                                 size_t n, unsigned int b)
+{
+    size_t k;
+    unsigned int distinct = 0;
+
+    for (k = 0; k < n; k++)
+        scratch[k] = addrs[k] >> b;
+    qsort(scratch, n, sizeof(*scratch), cmp_addr);
+    for (k = 0; k < n; k++)
+        if (k == 0 || scratch[k] != scratch[k-1])
+            distinct++;
+    return distinct;
+}
+
+/*
+ * eval_grid - Run the reference simulator on trace.f<i> for every
+ *     (s, E, b) in the grid and report misses against the
+ *     compulsory-miss bound for that block size
+ */
+void eval_grid(int i)
+{
+    unsigned int len, hits, misses, evictions, bound;
+    unsigned long long int addr, *addrs = NULL, *scratch;
+    size_t n = 0, cap = 0;
+    size_t si, ei, bi;
+    char buf[1000], cmd[255], filename[128];
+
+    /* Load the addresses of the filtered trace */
+    sprintf(filename, "trace.f%d", i);
+    FILE* fp = fopen(filename, "r");
+    assert(fp);
+    while (fgets(buf, 1000, fp) != NULL) {
+        if (buf[0] == 'I' || sscanf(buf+3, "%llx,%u", &addr, &len) != 2)
+            continue;
+        if (n == cap) {
+            cap = cap ? 2 * cap : 4096;
+            addrs = realloc(addrs, cap * sizeof(*addrs));
+            assert(addrs);
+        }
+        addrs[n++] = addr;
+    }
+    fclose(fp);
+    scratch = malloc((n ? n : 1) * sizeof(*scratch));
+    assert(scratch);
+
+    printf("Step 3: Geometry sweep for func %d (%s)\n", i, func_list[i].description);
+    printf("%4s%4s%4s%10s%12s%8s\n", "s", "E", "b", "misses", "compulsory", "ratio");
+    for (bi = 0; bi < GRID_LEN(grid_b); bi++) {
+        bound = count_blocks(addrs, scratch, n, grid_b[bi]);
+        for (si = 0; si < GRID_LEN(grid_s); si++) {
+            for (ei = 0; ei < GRID_LEN(grid_E); ei++) {
+                sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t %s > /dev/null",
+                        grid_s[si], grid_E[ei], grid_b[bi], filename);
+                system(cmd);
+
+                FILE* in_fp = fopen(".csim_results","r");
+                assert(in_fp);
+                fscanf(in_fp, "%u %u %u", &hits, &misses, &evictions);
+                fclose(in_fp);
+                printf("%4u%4u%4u%10u%12u%8.2f\n", grid_s[si], grid_E[ei],
+                       grid_b[bi], misses, bound,
+                       bound ? (double) misses / bound : 0.0);
+            }
+        }
+    }
+
+    free(scratch);
+    free(addrs);
+}
+
+/*
+ * map_char - One character per element: '.' for no misses, the count
+ *     up to 9, '#' beyond that
+ */
+static char map_char(unsigned int n)
+{
+    return n == 0 ? '.' : n <= 9 ? '0' + n : '#';
+}
+
+/*
+ * eval_missmap - Replay trace.f<i> through the reference simulator in
+ *     verbose mode and charge every miss to the element of A or B it
+ *     touched (A is viewed as [N][M], B as [M][N], as the functions see
+ *     them). Layout functions have their misses mapped back through the
+ *     layout, and misses on padding only count towards the totals. The
+ *     maps are written to missmap.f<i>.
+ */
+void eval_missmap(int i, unsigned int s, unsigned int E, unsigned int b)
+{
+    static unsigned int a_miss[MAXN * MAXN], b_miss[MAXN * MAXN];
+    unsigned long long int addr, off;
+    unsigned int len, in_a = 0, in_b = 0, other = 0;
+    int r, c, layout = func_list[i].layout, size = func_list[i].elem_size;
+    char buf[1000], cmd[255], filename[128], op;
+    FILE *in_fp, *out_fp;
+
+    if (a_base == 0 || b_base == 0) {
+        printf("Miss map: no A/B base addresses in .marker, skipped\n");
+        return;
+    }
+    memset(a_miss, 0, sizeof(a_miss));
+    memset(b_miss, 0, sizeof(b_miss));
+
+    sprintf(cmd, "./csim-ref -v -s %u -E %u -b %u -t trace.f%d > trace.verbose",
+            s, E, b, i);
+    system(cmd);
+    in_fp = fopen("trace.verbose", "r");
+    assert(in_fp);
+    while (fgets(buf, 1000, in_fp) != NULL) {
+        if (sscanf(buf, "%c %llx,%u", &op, &addr, &len) != 3 ||
+            strstr(buf, " miss") == NULL)
+            continue;
+
+        /* The element holding the first byte takes the miss */
+        if (addr >= a_base && (off = (addr - a_base) / size)
+            < (unsigned long long) layoutSize(layout, N, M)) {
+            if (layoutCoords(layout, N, M, off, &r, &c))
+                a_miss[r * M + c]++;
+            in_a++;
+        } else if (addr >= b_base && (off = (addr - b_base) / size)
+                   < (unsigned long long) layoutSize(layout, M, N)) {
+            if (layoutCoords(layout, M, N, off, &r, &c))
+                b_miss[r * N + c]++;
+            in_b++;
+        } else {
+            other++;
+        }
+    }
+    fclose(in_fp);
+    remove("trace.verbose");
+
+    sprintf(filename, "missmap.f%d", i);
+    out_fp = fopen(filename, "w");
+    assert(out_fp);
+    fprintf(out_fp, "func %d (%s): misses in A:%u B:%u elsewhere:%u\n",
+            i, func_list[i].description, in_a, in_b, other);
+    fprintf(out_fp, "\nA[%d][%d]\n", N, M);
+    for (r = 0; r < N; r++) {
+        for (c = 0; c < M; c++)
+            fputc(map_char(a_miss[r * M + c]), out_fp);
+        fputc('\n', out_fp);
+    }
+    fprintf(out_fp, "\nB[%d][%d]\n", M, N);
+    for (r = 0; r < M; r++) {
+        for (c = 0; c < N; c++)
+            fputc(map_char(b_miss[r * N + c]), out_fp);
+        fputc('\n', out_fp);
+    }
+    fclose(out_fp);
+
+    printf("Miss map: %s (A:%u B:%u elsewhere:%u)\n",
+           filename, in_a, in_b, other);
+}
+
+/*
+ * eval_time - Estimate the run time of trace.f<i> with csim's timing
+ *     model (memory latency of 100 cycles) on the graded cache
+ */
+void eval_time(int i, unsigned int s, unsigned int E, unsigned int b)
+{
+    char buf[1000], cmd[255];
+    double amat;
+    FILE* fp;
+
+    est_cycles[i] = -1;
+    sprintf(cmd, "./csim -s %u -E %u -b %u --mem-latency 100 -t trace.f%d > trace.timing",
+            s, E, b, i);
+    system(cmd);
+    if ((fp = fopen("trace.timing", "r")) == NULL)
+        return;
+    while (fgets(buf, 1000, fp) != NULL)
+        sscanf(buf, "timing: amat:%lf cycles:%lf", &amat, &est_cycles[i]);
+    fclose(fp);
+    remove("trace.timing");
+}
+
+/*
+ * print_ranking - List the validated functions from fastest to slowest
+ *     estimated time
+ */
+void print_ranking()
+{
+    int order[MAX_TRANS_FUNCS];
+    int i, j, n = 0, tmp;
+
+    for (i = 0; i < func_counter; i++)
+        if (func_list[i].correct && est_cycles[i] >= 0)
+            order[n++] = i;
+
+    /* Insertion sort - there are only a handful of functions */
+    for (i = 1; i < n; i++)
+        for (j = i; j > 0 && est_cycles[order[j]] < est_cycles[order[j-1]]; j--) {
+            tmp = order[j];
+            order[j] = order[j-1];
+            order[j-1] = tmp;
+        }
+
+    printf("\nRanking by estimated cycles (./csim --mem-latency 100)\n");
+    for (i = 0; i < n; i++)
+        printf("%2d. func %d (%s): cycles:%.0f misses:%u\n", i + 1, order[i],
+               func_list[order[i]].description, est_cycles[order[i]],
+               func_list[order[i]].num_misses);
+}
+
+/*
+ * open_counter - Open a disabled user-space counter for this process,
+ *     returning its fd or -1 if the kernel or hardware does not have it
+ */
+static int open_counter(unsigned int type, unsigned long long int config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * now_ns - Monotonic clock in nanoseconds
+ */
+static long long int now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * flush_matrices - Evict the first bytes of bench_A and bench_B from every
+ *     cache level, so each run starts cold like the simulated one
+ */
+static void flush_matrices(long bytes)
+{
+    char *p;
+
+    for (p = (char *) bench_A; p < (char *) bench_A + bytes; p += 64)
+        _mm_clflush(p);
+    for (p = (char *) bench_B; p < (char *) bench_B + bytes; p += 64)
+        _mm_clflush(p);
+    _mm_mfence();
+}
+
+/*
+ * bench_func - Run function i natively BENCH_RUNS times with the
+ *     counters enabled only around the calls, and store the per-run
+ *     averages in ctr (-1 where a counter is missing) and *ns. Inputs
+ *     are prepared as tracegen does. Returns 0 if the function's
+ *     matrices do not fit.
+ */
+static int bench_func(int i, double ctr[NUM_CTRS], double *ns)
+{
+    int run, k, layout = func_list[i].layout;
+    long long int total_ns = 0, val;
+    long n, size = (long) M * N * func_list[i].elem_size;
+
+    if (size > (long) sizeof(bench_A) ||
+        (layout != LAYOUT_ROW_MAJOR &&
+         (layoutSize(layout, N, M) > MAXN * MAXN || layoutSize(layout, M, N) > MAXN * MAXN)))
+        return 0;
+
+    for (n = 0; n < size / (long) sizeof(int); n++)
+        (&bench_A[0][0])[n] = rand();
+    if (layout != LAYOUT_ROW_MAJOR) {
+        memcpy(bench_rows, bench_A, sizeof(int) * M * N);
+        toLayout(layout, N, M, bench_rows, &bench_A[0][0]);
+    }
+
+    for (k = 0; k < NUM_CTRS; k++)
+        if (ctr_fd[k] >= 0)
+            ioctl(ctr_fd[k], PERF_EVENT_IOC_RESET, 0);
+
+    for (run = 0; run < BENCH_RUNS; run++) {
+        if (func_list[i].inplace_ptr)
+            memcpy(bench_B, bench_A, sizeof(int) * M * N);
+        flush_matrices(layout != LAYOUT_ROW_MAJOR
+                       ? (long) sizeof(int) * (layoutSize(layout, N, M) > layoutSize(layout, M, N)
+                                               ? layoutSize(layout, N, M) : layoutSize(layout, M, N))
+                       : size);
+
+        for (k = 0; k < NUM_CTRS; k++)
+            if (ctr_fd[k] >= 0)
+                ioctl(ctr_fd[k], PERF_EVENT_IOC_ENABLE, 0);
+        total_ns -= now_ns();
+        if (func_list[i].typed_ptr)
+            (*func_list[i].typed_ptr)(M, N, bench_A, bench_B);
+        else if (func_list[i].inplace_ptr)
+            (*func_list[i].inplace_ptr)(M, N, (int (*)[M]) bench_B);
+        else
+            (*func_list[i].func_ptr)(M, N, (int (*)[M]) bench_A, (int (*)[N]) bench_B);
+        total_ns += now_ns();
+        for (k = 0; k < NUM_CTRS; k++)
+            if (ctr_fd[k] >= 0)
+                ioctl(ctr_fd[k], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (k = 0; k < NUM_CTRS; k++)
+        ctr[k] = ctr_fd[k] >= 0 && read(ctr_fd[k], &val, sizeof(val)) == sizeof(val)
+            ? (double) val / BENCH_RUNS : -1;
+    *ns = (double) total_ns / BENCH_RUNS;
+    return 1;
+}
+
+/*
+ * print_count - Print a right-aligned count, or "-" if it is unknown
+ */
+static void print_count(int width, double count)
+{
+    if (count < 0)
+        printf(" %*s", width, "-");
+    else
+        printf(" %*.0f", width, count);
+}
+
+/*
+ * eval_bench - Run every registered function natively and print its
+ *     hardware miss and cycle counts next to the simulated misses. Falls
+ *     back to clock_gettime timing alone when perf_event_open is not
+ *     available (no PMU, or kernel.perf_event_paranoid too high).
+ */
+void eval_bench()
+{
+    double ctr[NUM_CTRS], ns;
+    int i, k, have_ctrs = 0;
+
+    ctr_fd[CTR_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    ctr_fd[CTR_L1D] = open_counter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                                   (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    ctr_fd[CTR_LLC] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    for (k = 0; k < NUM_CTRS; k++)
+        have_ctrs |= ctr_fd[k] >= 0;
+
+    printf("\nNative benchmark (%dx%d, %d cold-cache runs per function, averages per run)\n",
+           M, N, BENCH_RUNS);
+    if (!have_ctrs)
+        printf("Hardware counters unavailable, timing with clock_gettime only\n");
+    printf("%4s %10s %10s %10s %10s %10s  %s\n", "func", "sim-misses",
+           "L1D-misses", "LLC-misses", "cycles", "ns", "description");
+
+    for (i = 0; i < func_counter; i++) {
+        printf("%4d", i);
+        print_count(10, func_list[i].correct ? (double) func_list[i].num_misses : -1);
+        if (bench_func(i, ctr, &ns)) {
+            print_count(10, ctr[CTR_L1D]);
+            print_count(10, ctr[CTR_LLC]);
+            print_count(10, ctr[CTR_CYCLES]);
+            print_count(10, ns);
+        } else {
+            printf(" %43s", "does not fit");
+        }
+        printf("  %s\n", func_list[i].description);
+    }
+
+    for (k = 0; k < NUM_CTRS; k++)
+        if (ctr_fd[k] >= 0)
+            close(ctr_fd[k]);
+}
+
 /* 
  * eval_perf - Evaluate the performance of the registered transpose functions
  */
@@ -78,7 +494,9 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
         /* Get the start and end marker addresses */
         FILE* marker_fp = fopen(".marker", "r");
         assert(marker_fp);
-        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
+        a_base = b_base = 0;
+        fscanf(marker_fp, "%llx %llx %llx %llx", &marker_start, &marker_end,
+               &a_base, &b_base);
         fclose(marker_fp);
 
 
@@ -102,6 +520,15 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
         flag = 0;
         while (fgets(buf, 1000, full_trace_fp) != NULL) {
 
+            /* Instruction fetches are only kept on request, and only
+               between the markers */
+            if (keep_instr && flag && buf[0]=='I' && buf[1]==' ') {
+                sscanf(buf+3, "%llx,%u", &addr, &len);
+                if (addr < 0xffffffff)
+                    fputs(buf, part_trace_fp);
+                continue;
+            }
+
             /* We are only interested in memory access instructions */
             if (buf[0]==' ' && buf[2]==' ' &&
                 (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
@@ -149,14 +576,32 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
         func_list[i].num_hits = hits;
         func_list[i].num_misses = misses;
         func_list[i].num_evictions = evictions;
-        printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
-               i, func_list[i].description, hits, misses, evictions);
+        printf("func %u (%s%s): hits:%u, misses:%u, evictions:%u\n",
+               i, func_list[i].description,
+               func_list[i].inplace_ptr ? ", in-place"
+               : func_list[i].layout == LAYOUT_TILED ? ", tiled layout"
+               : func_list[i].layout == LAYOUT_MORTON ? ", Morton layout" : "",
+               hits, misses, evictions);
     
         /* If it is transpose_submit(), record number of misses */
         if (results.funcid == i) {
             results.misses = misses;
         }
+
+        /* Optionally show which elements missed */
+        if (missmap)
+            eval_missmap(i, s, E, b);
+
+        /* Optionally show how the function holds up on other geometries */
+        if (grid)
+            eval_grid(i);
+
+        if (rank)
+            eval_time(i, s, E, b);
     }
+
+    if (rank)
+        print_ranking();
   
 }
 
@@ -164,9 +609,14 @@ void eval_perf(unsigned int s, unsigned int E, unsigned int b)
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-hgimpr] -M <rows> -N <cols>\n", argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
+    printf("  -g          Also sweep a grid of (s,E,b) and compare against compulsory misses.\n");
+    printf("  -i          Keep instruction fetches (I records) in trace.fN.\n");
+    printf("  -m          Write a per-element miss map of A and B to missmap.fN.\n");
+    printf("  -p          Also run each function natively and read L1D/LLC misses and cycles.\n");
+    printf("  -r          Rank the functions by estimated cycles (needs ./csim).\n");
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
     printf("Example: %s -M 8 -N 8\n", argv[0]);       
@@ -199,7 +649,7 @@ int main(int argc, char* argv[])
 {
     char c;
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:hgimpr")) != -1) {
         switch(c) {
         case 'M':
             M = atoi(optarg);
@@ -207,6 +657,21 @@ int main(int argc, char* argv[])
         case 'N':
             N = atoi(optarg);
             break;
+        case 'g':
+            grid = 1;
+            break;
+        case 'i':
+            keep_instr = 1;
+            break;
+        case 'm':
+            missmap = 1;
+            break;
+        case 'p':
+            bench = 1;
+            break;
+        case 'r':
+            rank = 1;
+            break;
         case 'h':
             usage(argv);
             exit(0);
@@ -240,10 +705,14 @@ int main(int argc, char* argv[])
     }
 
     /* Time out and give up after a while */
-    alarm(120);
+    alarm(grid ? 1200 : 120);
 
     /* Check the performance of the student's transpose function */
     eval_perf(5, 1, 5);
+
+    /* Optionally compare the simulated misses with the hardware */
+    if (bench)
+        eval_bench();
   
     /* Emit the results for this particular test */
     if (results.funcid == -1) {
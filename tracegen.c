@@ -25,8 +25,12 @@ extern void registerFunctions();
 /* Markers used to bound trace regions of interest */
 volatile char MARKER_START, MARKER_END;
 
-static int A[256][256];
-static int B[256][256];
+/* Room for 256 x 256 elements of MAX_ELEM_SIZE bytes. Rows start on a cache line,
+   as they did before the alignment was spelled out, so miss counts are unchanged */
+static int A[256 * MAX_ELEM_SIZE / sizeof(int)][256] __attribute__((aligned(64)));
+static int B[256 * MAX_ELEM_SIZE / sizeof(int)][256] __attribute__((aligned(64)));
+static int A_rows[256 * 256];   /* row-major A while A holds it in a layout */
+static int B_rows[256 * 256];   /* row-major copy of a layout function's B */
 static int M;
 static int N;
 
@@ -46,6 +50,73 @@ int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     return 1;
 }
 
+/*
+ * validate_typed - Check B against A^T for a function on size-byte
+ *     elements, comparing the elements byte by byte
+ */
+int validate_typed(int fn, int M, int N, int size, char *A, char *B) {
+    for(int i=0;i<N;i++) {
+        for(int j=0;j<M;j++) {
+            if(memcmp(&B[((long) j*N+i)*size], &A[((long) i*M+j)*size], size)) {
+                printf("Validation failed on function %d! Wrong element at B[%d][%d]\n",fn,j,i);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * run_func - Run registered function fn between the markers and validate it.
+ *     In-place functions get a copy of A in B's storage, made outside the
+ *     markers so that only the transpose itself shows up in the trace.
+ *     Layout functions likewise get A converted into their layout in A's
+ *     storage, and their B converted back before validation. Typed
+ *     functions get A's storage refilled with random bytes for M x N of
+ *     their elements.
+ */
+int run_func(int fn) {
+    int layout = func_list[fn].layout;
+    int size = func_list[fn].elem_size;
+
+    if (func_list[fn].typed_ptr) {
+        if ((long) M * N * size > (long) sizeof(A)) {
+            printf("Validation failed on function %d! %dx%d does not fit in A\n", fn, N, M);
+            return 0;
+        }
+        for (long i = 0; i < (long) M * N * size / (long) sizeof(int); i++)
+            (&A[0][0])[i] = rand();
+        MARKER_START = 33;
+        (*func_list[fn].typed_ptr)(M, N, A, B);
+        MARKER_END = 34;
+        return validate_typed(fn, M, N, size, (char *) A, (char *) B);
+    } else if (layout != LAYOUT_ROW_MAJOR) {
+        if (layoutSize(layout, N, M) > 256 * 256 || layoutSize(layout, M, N) > 256 * 256) {
+            printf("Validation failed on function %d! %dx%d does not fit in its layout\n",
+                   fn, N, M);
+            return 0;
+        }
+        memcpy(A_rows, A, sizeof(int) * M * N);
+        toLayout(layout, N, M, A_rows, &A[0][0]);
+        MARKER_START = 33;
+        (*func_list[fn].func_ptr)(M, N, A, B);
+        MARKER_END = 34;
+        fromLayout(layout, M, N, &B[0][0], B_rows);
+        memcpy(A, A_rows, sizeof(int) * M * N);
+        return validate(fn, M, N, (int (*)[M]) A_rows, (int (*)[N]) B_rows);
+    } else if (func_list[fn].inplace_ptr) {
+        memcpy(B, A, sizeof(int) * M * N);
+        MARKER_START = 33;
+        (*func_list[fn].inplace_ptr)(M, N, B);
+        MARKER_END = 34;
+    } else {
+        MARKER_START = 33;
+        (*func_list[fn].func_ptr)(M, N, A, B);
+        MARKER_END = 34;
+    }
+    return validate(fn,M,N,A,B);
+}
+
 int main(int argc, char* argv[]){
     int i;
 
@@ -76,28 +147,25 @@ int main(int argc, char* argv[]){
     /* Fill A with data */
     initMatrix(M,N, A, B); 
 
-    /* Record marker addresses */
+    /* Record marker addresses, then the bases of A and B so that
+       misses can be mapped back to matrix elements */
     FILE* marker_fp = fopen(".marker","w");
     assert(marker_fp);
-    fprintf(marker_fp, "%llx %llx", 
+    fprintf(marker_fp, "%llx %llx %llx %llx", 
             (unsigned long long int) &MARKER_START,
-            (unsigned long long int) &MARKER_END );
+            (unsigned long long int) &MARKER_END,
+            (unsigned long long int) A,
+            (unsigned long long int) B );
     fclose(marker_fp);
 
     if (-1==selectedFunc) {
         /* Invoke registered transpose functions */
         for (i=0; i < func_counter; i++) {
-            MARKER_START = 33;
-            (*func_list[i].func_ptr)(M, N, A, B);
-            MARKER_END = 34;
-            if (!validate(i,M,N,A,B))
+            if (!run_func(i))
                 return i+1;
         }
     } else {
-        MARKER_START = 33;
-        (*func_list[selectedFunc].func_ptr)(M, N, A, B);
-        MARKER_END = 34;
-        if (!validate(selectedFunc,M,N,A,B))
+        if (!run_func(selectedFunc))
             return selectedFunc+1;
 
     }
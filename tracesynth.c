@@ -0,0 +1,405 @@
+/*
+ * tracesynth.c - Synthetic trace generator for benchmarking the cache
+ * simulator on workloads far larger than the valgrind traces.
+ *
+ * Emits a reproducible stream of accesses in lackey text format (the
+ * format read by csim and csim-ref) or in the binary format described
+ * in cachelab.h. The same seed and options always produce the same
+ * trace.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <math.h>
+#include "cachelab.h"
+
+/* Size of the output buffer */
+#define OUT_CAP (1 << 16)
+
+/* Workloads the generator knows how to produce */
+enum workload { W_SEQ, W_STRIDE, W_RANDOM, W_ZIPF, W_CHASE, W_TILE };
+static const char *workload_names[] = {
+    "seq", "stride", "random", "zipf", "chase", "tile"
+};
+
+/* Globals set on the command line */
+static enum workload workload = W_SEQ;
+static unsigned long long count = 1000000;    /* accesses to emit */
+static unsigned long long base = 0x10000000;  /* lowest address used */
+static unsigned long long footprint = 1 << 20; /* bytes touched */
+static unsigned long long stride = 64;        /* stride/node size in bytes */
+static int elem = 4;                          /* access size in bytes */
+static double theta = 0.99;                   /* zipf exponent */
+static int M = 64, N = 64, T = 8;             /* tile sweep geometry */
+static int store_pct = 0, modify_pct = 0;     /* op mix */
+static unsigned long long seed = 1;
+static int binary = 0;
+
+/* Output state */
+static FILE *out_fp;
+static char out_buf[OUT_CAP];
+static size_t out_len = 0;
+static unsigned long long rng_state;
+
+/*
+ * rng_next - splitmix64; small state, fast, and good enough for traces
+ */
+static inline unsigned long long rng_next(void)
+{
+    unsigned long long z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * rng_double - Uniform double in [0, 1)
+ */
+static inline double rng_double(void)
+{
+    return (rng_next() >> 11) * 0x1.0p-53;
+}
+
+/*
+ * flush_out - Write out the buffered trace
+ */
+static void flush_out(void)
+{
+    if (out_len && fwrite(out_buf, 1, out_len, out_fp) != out_len) {
+        perror("tracesynth: write");
+        exit(1);
+    }
+    out_len = 0;
+}
+
+/*
+ * emit - Append one access to the trace. Formats by hand since printf
+ *     would dominate the run time for billions of records.
+ */
+static inline void emit(char op, unsigned long long addr, int size)
+{
+    static const char hex[] = "0123456789abcdef";
+    char *p;
+    int i, digits;
+
+    if (out_len + 32 > OUT_CAP)
+        flush_out();
+    p = out_buf + out_len;
+
+    if (binary) {
+        for (i = 0; i < 8; i++)
+            p[i] = (char) (addr >> (8 * i));
+        p[8] = op;
+        p[9] = (char) size;
+        out_len += TRACE_REC_SIZE;
+        return;
+    }
+
+    /* " L 0421c7f0,4\n" - at least 8 hex digits, like lackey */
+    for (digits = 8; digits < 16 && (addr >> (4 * digits)); digits++);
+    *p++ = ' ';
+    *p++ = op;
+    *p++ = ' ';
+    for (i = digits - 1; i >= 0; i--)
+        *p++ = hex[(addr >> (4 * i)) & 0xf];
+    *p++ = ',';
+    if (size >= 10)
+        *p++ = '0' + size / 10;
+    *p++ = '0' + size % 10;
+    *p++ = '\n';
+    out_len = p - out_buf;
+}
+
+/*
+ * pick_op - Draw a load, store or modify according to the op mix
+ */
+static inline char pick_op(void)
+{
+    int r;
+
+    if (store_pct == 0 && modify_pct == 0)
+        return 'L';
+    r = (int) (rng_next() % 100);
+    if (r < store_pct)
+        return 'S';
+    if (r < store_pct + modify_pct)
+        return 'M';
+    return 'L';
+}
+
+/*
+ * gen_linear - Sequential (stride == elem) and fixed-stride streams that
+ *     wrap around the footprint
+ */
+static void gen_linear(unsigned long long step)
+{
+    unsigned long long k, off = 0;
+
+    for (k = 0; k < count; k++) {
+        emit(pick_op(), base + off, elem);
+        off += step;
+        if (off >= footprint)
+            off -= footprint;
+    }
+}
+
+/*
+ * gen_random - Uniformly random elements of the footprint
+ */
+static void gen_random(void)
+{
+    unsigned long long k, items = footprint / elem;
+
+    for (k = 0; k < count; k++)
+        emit(pick_op(), base + (rng_next() % items) * elem, elem);
+}
+
+/* Helpers for the Zipf sampler, stable near x == 0 */
+static double zipf_helper1(double x)
+{
+    return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+static double zipf_helper2(double x)
+{
+    return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+}
+static double zipf_h(double x)
+{
+    return exp(-theta * log(x));
+}
+static double zipf_hint(double x)
+{
+    double lx = log(x);
+    return zipf_helper2((1 - theta) * lx) * lx;
+}
+static double zipf_hint_inv(double x)
+{
+    double t = x * (1 - theta);
+    if (t < -1)
+        t = -1;
+    return exp(zipf_helper1(t) * x);
+}
+
+/*
+ * gen_zipf - Zipf-distributed hot set over the elements of the
+ *     footprint, sampled by rejection-inversion (Hormann & Derflinger)
+ *     in O(1) time and memory per access. Ranks are scattered over the
+ *     footprint by a fixed odd multiplier so the hot elements don't all
+ *     share a handful of blocks.
+ */
+static void gen_zipf(void)
+{
+    unsigned long long k, rank, items = footprint / elem, mult;
+    double x1 = zipf_hint(1.5) - 1;
+    double xn = zipf_hint(items + 0.5);
+    double sq = 2 - zipf_hint_inv(zipf_hint(2.5) - zipf_h(2));
+    double u, x;
+
+    /* Multiplier coprime to items makes rank -> element a bijection */
+    for (mult = 0x9e3779b1ULL % items | 1; ; mult += 2) {
+        unsigned long long a = mult, c = items, t;
+        while (c) { t = a % c; a = c; c = t; }
+        if (a == 1 || items == 1)
+            break;
+    }
+
+    for (k = 0; k < count; k++) {
+        for (;;) {
+            u = xn + rng_double() * (x1 - xn);
+            x = zipf_hint_inv(u);
+            rank = (unsigned long long) (x + 0.5);
+            if (rank < 1)
+                rank = 1;
+            else if (rank > items)
+                rank = items;
+            if (rank - x <= sq || u >= zipf_hint(rank + 0.5) - zipf_h(rank))
+                break;
+        }
+        emit(pick_op(), base + ((rank - 1) * mult % items) * elem, elem);
+    }
+}
+
+/*
+ * gen_chase - Pointer chasing through one random cycle over all
+ *     stride-byte nodes of the footprint (Sattolo's algorithm), so every
+ *     load depends on the previous one and no two nodes repeat early
+ */
+static void gen_chase(void)
+{
+    unsigned long long k, nodes = footprint / stride, j, cur = 0;
+    unsigned int *next, tmp;
+
+    if (nodes > 0xffffffffULL) {
+        fprintf(stderr, "tracesynth: too many nodes for pointer chasing\n");
+        exit(1);
+    }
+    next = malloc(nodes * sizeof(*next));
+    if (!next) {
+        perror("tracesynth: malloc");
+        exit(1);
+    }
+    for (k = 0; k < nodes; k++)
+        next[k] = (unsigned int) k;
+    for (k = nodes - 1; k > 0; k--) {
+        j = rng_next() % k;
+        tmp = next[k];
+        next[k] = next[j];
+        next[j] = tmp;
+    }
+
+    for (k = 0; k < count; k++) {
+        emit('L', base + cur * stride, 8);
+        cur = next[cur];
+    }
+    free(next);
+}
+
+/*
+ * gen_tile - Tiled transpose sweep of an N x M matrix A into B, laid out
+ *     back to back like tracegen's static arrays, repeated until count
+ *     accesses have been emitted
+ */
+static void gen_tile(void)
+{
+    unsigned long long k = 0;
+    unsigned long long a_base = base;
+    unsigned long long b_base = base + (unsigned long long) M * N * elem;
+    int row, col, i, j;
+
+    for (;;) {
+        for (row = 0; row < N; row += T) {
+            for (col = 0; col < M; col += T) {
+                for (i = row; i < row + T && i < N; i++) {
+                    for (j = col; j < col + T && j < M; j++) {
+                        if (k++ == count)
+                            return;
+                        emit('L', a_base + ((unsigned long long) i * M + j) * elem, elem);
+                        if (k++ == count)
+                            return;
+                        emit('S', b_base + ((unsigned long long) j * N + i) * elem, elem);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * parse_num - Parse a number with an optional K, M or G (binary) suffix
+ */
+static unsigned long long parse_num(const char *str)
+{
+    char *end;
+    unsigned long long v = strtoull(str, &end, 0);
+
+    switch (*end) {
+    case 'k': case 'K': v <<= 10; break;
+    case 'm': case 'M': v <<= 20; break;
+    case 'g': case 'G': v <<= 30; break;
+    }
+    return v;
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-hb] [-w <workload>] [-n <count>] [options]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h              Print this help message.\n");
+    printf("  -w <workload>   seq, stride, random, zipf, chase or tile (default seq)\n");
+    printf("  -n <count>      Number of accesses (default 1M)\n");
+    printf("  -a <addr>       Base address (default 0x10000000)\n");
+    printf("  -f <bytes>      Footprint of seq/stride/random/zipf/chase (default 1M)\n");
+    printf("  -s <bytes>      Stride, or node size for chase (default 64)\n");
+    printf("  -e <bytes>      Access size (default 4)\n");
+    printf("  -z <theta>      Zipf exponent (default 0.99)\n");
+    printf("  -M/-N <n>       Matrix columns/rows for tile (default 64)\n");
+    printf("  -T <n>          Tile edge for tile (default 8)\n");
+    printf("  -W <pct>        Percent of accesses that are stores (default 0)\n");
+    printf("  -X <pct>        Percent of accesses that are modifies (default 0)\n");
+    printf("  -S <seed>       Random seed (default 1)\n");
+    printf("  -b              Write the binary trace format instead of text\n");
+    printf("  -o <file>       Output file (default stdout)\n");
+    printf("Sizes and counts accept K, M and G suffixes.\n");
+    printf("Example: %s -w zipf -n 1G -f 64M -W 30 -b -o zipf.bin\n", argv[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    int c, i;
+    char *out_file = NULL;
+
+    while ((c = getopt(argc, argv, "hw:n:a:f:s:e:z:M:N:T:W:X:S:bo:")) != -1) {
+        switch (c) {
+        case 'w':
+            for (i = 0; i <= W_TILE; i++)
+                if (strcmp(optarg, workload_names[i]) == 0)
+                    break;
+            if (i > W_TILE) {
+                printf("Error: Unknown workload %s\n", optarg);
+                usage(argv);
+                exit(1);
+            }
+            workload = i;
+            break;
+        case 'n': count = parse_num(optarg); break;
+        case 'a': base = parse_num(optarg); break;
+        case 'f': footprint = parse_num(optarg); break;
+        case 's': stride = parse_num(optarg); break;
+        case 'e': elem = atoi(optarg); break;
+        case 'z': theta = atof(optarg); break;
+        case 'M': M = atoi(optarg); break;
+        case 'N': N = atoi(optarg); break;
+        case 'T': T = atoi(optarg); break;
+        case 'W': store_pct = atoi(optarg); break;
+        case 'X': modify_pct = atoi(optarg); break;
+        case 'S': seed = parse_num(optarg); break;
+        case 'b': binary = 1; break;
+        case 'o': out_file = optarg; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (elem <= 0 || elem > 99 || stride == 0 || footprint < (unsigned long long) elem
+        || footprint < stride || M <= 0 || N <= 0 || T <= 0 || theta <= 0
+        || store_pct < 0 || modify_pct < 0 || store_pct + modify_pct > 100) {
+        printf("Error: Invalid workload parameters\n");
+        usage(argv);
+        exit(1);
+    }
+
+    out_fp = out_file ? fopen(out_file, "wb") : stdout;
+    if (!out_fp) {
+        perror("tracesynth: fopen");
+        exit(1);
+    }
+    if (binary && fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LEN, out_fp) != TRACE_MAGIC_LEN) {
+        perror("tracesynth: write");
+        exit(1);
+    }
+
+    rng_state = seed;
+    switch (workload) {
+    case W_SEQ:    gen_linear(elem); break;
+    case W_STRIDE: gen_linear(stride); break;
+    case W_RANDOM: gen_random(); break;
+    case W_ZIPF:   gen_zipf(); break;
+    case W_CHASE:  gen_chase(); break;
+    case W_TILE:   gen_tile(); break;
+    }
+
+    flush_out();
+    if (out_fp != stdout)
+        fclose(out_fp);
+    return 0;
+}
@@ -13,12 +13,33 @@
  * on a 1KB direct mapped cache with a block size of 32 bytes.
  */ 
 #include <stdio.h>
+#include <stdint.h>
+#include <emmintrin.h>
 #include "cachelab.h"
 
+/* 16-byte complex element of the typed kernels */
+typedef struct { double re, im; } complex_t;
+
 int is_transpose(int M, int N, int A[N][M], int B[M][N]);
 void transpose_32(int M, int N, int A[N][M], int B[M][N]);
 void transpose_64(int M, int N, int A[N][M], int B[M][N]);
 void transpose_other(int M, int N, int A[N][M], int B[M][N]);
+void transpose_oblivious(int M, int N, int A[N][M], int B[M][N]);
+void transpose_morton(int M, int N, int A[N][M], int B[M][N]);
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N], int r0, int r1, int c0, int c1, int tile);
+void transpose_panels(int M, int N, int A[N][M], int B[M][N]);
+void transpose_tiled_layout(int M, int N, int A[N][M], int B[M][N]);
+void transpose_morton_layout(int M, int N, int A[N][M], int B[M][N]);
+void transpose_float(int M, int N, void *A, void *B);
+void transpose_double(int M, int N, void *A, void *B);
+void transpose_int64(int M, int N, void *A, void *B);
+void transpose_complex(int M, int N, void *A, void *B);
+void transpose_float_sse(int M, int N, void *A, void *B);
+void transpose_double_sse(int M, int N, void *A, void *B);
+void transpose_int64_sse(int M, int N, void *A, void *B);
+void transpose_complex_sse(int M, int N, void *A, void *B);
+void transpose_inplace_square(int M, int N, int A[N][M]);
+void transpose_inplace_cycle(int M, int N, int A[N][M]);
 
 /* 
  * transpose_submit - This is the solution transpose function that you
@@ -191,6 +212,481 @@ void transpose_other(int M, int N, int A[N][M], int B[M][N]){
 	}
 }
 
+/*
+ * Base case edge length for the cache-oblivious kernels below. This is deliberately
+ * not tied to any cache geometry - it only needs to be small enough that a base tile
+ * of A and its transposed tile of B fit in any cache the kernels are run against.
+ */
+#define CO_BASE 8
+
+/*
+ * transpose_tile - Transpose the sub-block A[r0..r1)[c0..c1) into B
+ *					Shared base case of the cache-oblivious kernels
+ * Params:
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Input matrix - the one transposed from
+ *	B[N][M] - Input matrix - the one transposed to
+ *	r0, r1 - First and one-past-last row of the block
+ *	c0, c1 - First and one-past-last column of the block
+ * Returns: void
+ */
+static void transpose_tile(int M, int N, int A[N][M], int B[M][N], int r0, int r1, int c0, int c1){
+
+	int n, m;		// Indecies for rows and columns in the block
+	int d_val = 0;	// Hold value of diagonal element found in the block
+	int diag = -1;	// Hold position of diagonal element found in the block (-1 if none on this row)
+
+	for (n = r0; n < r1; n++) {
+		for (m = c0; m < c1; m++) {
+
+			// Off-diagonal elements are transposed directly
+			if (n != m) {
+				B[m][n] = A[n][m];
+			// Diagonal element is deferred so A's row and B's row don't evict each other mid-row
+			} else {
+				diag = n;
+				d_val = A[n][m];
+			}
+		}
+		// Write back the deferred diagonal element, if this row had one
+		if (diag >= 0) {
+			B[diag][diag] = d_val;
+			diag = -1;
+		}
+	}
+}
+
+/*
+ * transpose_oblivious_rec - Recursive step of transpose_oblivious
+ *					Halves the longer dimension of the block until it fits the base case
+ * Params:
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Input matrix - the one transposed from
+ *	B[N][M] - Input matrix - the one transposed to
+ *	r0, r1 - First and one-past-last row of the block
+ *	c0, c1 - First and one-past-last column of the block
+ * Returns: void
+ */
+static void transpose_oblivious_rec(int M, int N, int A[N][M], int B[M][N], int r0, int r1, int c0, int c1){
+
+	int rows = r1 - r0;		// Height of the current block
+	int cols = c1 - c0;		// Width of the current block
+
+	// Small enough - transpose directly
+	if (rows <= CO_BASE && cols <= CO_BASE) {
+		transpose_tile(M, N, A, B, r0, r1, c0, c1);
+
+	// Taller than wide - split the rows
+	} else if (rows >= cols) {
+		transpose_oblivious_rec(M, N, A, B, r0, r0 + rows / 2, c0, c1);
+		transpose_oblivious_rec(M, N, A, B, r0 + rows / 2, r1, c0, c1);
+
+	// Wider than tall - split the columns
+	} else {
+		transpose_oblivious_rec(M, N, A, B, r0, r1, c0, c0 + cols / 2);
+		transpose_oblivious_rec(M, N, A, B, r0, r1, c0 + cols / 2, c1);
+	}
+}
+
+/*
+ * transpose_oblivious - Cache-oblivious recursive matrix transposition
+ 					Works for any dimensions and needs no per-geometry tile size, unlike
+ 					the switch(N) kernels above which are tuned for the graded cache only
+ * Params: 
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Input matrix - the one transposed from
+ *	B[N][M] - Input matrix - the one transposed to
+ * Returns: void
+ */
+char transpose_oblivious_desc[] = "Cache-oblivious recursive transpose";
+void transpose_oblivious(int M, int N, int A[N][M], int B[M][N]){
+
+	transpose_oblivious_rec(M, N, A, B, 0, N, 0, M);
+}
+
+/*
+ * transpose_blocked - Transpose A[r0..r1)[c0..c1) into B tile by tile, one column panel
+ *					of A (= row panel of B) at a time, so B is written front to back.
+ *					This is the tile order of mmtrans, which calls it once per panel
+ *					of its memory-mapped files; transpose_panels runs the same order here
+ *					so the simulator can evaluate it.
+ * Params:
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Input matrix - the one transposed from
+ *	B[N][M] - Input matrix - the one transposed to
+ *	r0, r1 - First and one-past-last row of the region
+ *	c0, c1 - First and one-past-last column of the region
+ *	tile - Edge of the tiles handed to transpose_tile
+ * Returns: void
+ */
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N], int r0, int r1, int c0, int c1, int tile){
+
+	int row, col;	// Corner of the current tile
+
+	for (col = c0; col < c1; col += tile) {
+		for (row = r0; row < r1; row += tile) {
+			transpose_tile(M, N, A, B, row, row + tile < r1 ? row + tile : r1,
+						   col, col + tile < c1 ? col + tile : c1);
+		}
+	}
+}
+
+/*
+ * transpose_panels - Column-panel tiled transposition, in the tile order mmtrans uses
+ * Params: 
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Input matrix - the one transposed from
+ *	B[N][M] - Input matrix - the one transposed to
+ * Returns: void
+ */
+char transpose_panels_desc[] = "Column-panel tiled transpose (mmtrans order)";
+void transpose_panels(int M, int N, int A[N][M], int B[M][N]){
+
+	transpose_blocked(M, N, A, B, 0, N, 0, M, CO_BASE);
+}
+
+/*
+ * morton_compact - Gather the even bits of z into the low half of the result
+ *					Used to turn a Morton (Z-order) index back into one coordinate
+ * Params:
+ *	z - Morton index (pass z >> 1 to get the second coordinate)
+ * Returns: the de-interleaved coordinate
+ */
+static int morton_compact(unsigned int z){
+
+	z &= 0x55555555;
+	z = (z | (z >> 1)) & 0x33333333;
+	z = (z | (z >> 2)) & 0x0f0f0f0f;
+	z = (z | (z >> 4)) & 0x00ff00ff;
+	z = (z | (z >> 8)) & 0x0000ffff;
+	return (int) z;
+}
+
+/*
+ * transpose_morton - Cache-oblivious transposition walking base tiles in Morton (Z) order
+ 					Same tiles as transpose_oblivious, but visited iteratively along the
+ 					Z-order curve so consecutive tiles stay close in both A and B
+ * Params: 
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Input matrix - the one transposed from
+ *	B[N][M] - Input matrix - the one transposed to
+ * Returns: void
+ */
+char transpose_morton_desc[] = "Cache-oblivious Morton-order transpose";
+void transpose_morton(int M, int N, int A[N][M], int B[M][N]){
+
+	int tile_rows = (N + CO_BASE - 1) / CO_BASE;	// Number of base tiles down the matrix
+	int tile_cols = (M + CO_BASE - 1) / CO_BASE;	// Number of base tiles across the matrix
+	int side = 1;		// Power-of-two side of the Z-order square covering all tiles
+	int z, tr, tc;		// Morton index and the tile row/column it maps to
+
+	while (side < tile_rows || side < tile_cols) {
+		side <<= 1;
+	}
+
+	// Walk the Z curve, skipping the tiles that fall outside a non-square matrix
+	for (z = 0; z < side * side; z++) {
+		tr = morton_compact(z >> 1);
+		tc = morton_compact(z);
+
+		if (tr < tile_rows && tc < tile_cols) {
+			transpose_tile(M, N, A, B,
+				tr * CO_BASE, (tr + 1) * CO_BASE < N ? (tr + 1) * CO_BASE : N,
+				tc * CO_BASE, (tc + 1) * CO_BASE < M ? (tc + 1) * CO_BASE : M);
+		}
+	}
+}
+
+/*
+ * layout_tile - Transpose one contiguous LAYOUT_TILE x LAYOUT_TILE tile of A into one of B
+ 					Each row of the A tile is copied to the same row of the B tile, then the
+ 					B tile is transposed in place. A and B tiles each span LAYOUT_TILE lines
+ 					of 32 bytes, so even when they map to the same sets every line of either
+ 					tile misses once.
+ * Params:
+ *	a - First element of the A tile
+ *	b - First element of the B tile
+ * Returns: void
+ */
+static void layout_tile(int *a, int *b){
+
+	int n, m;							// Indecies for rows and columns in the tile
+	int t0, t1, t2, t3, t4, t5, t6, t7;	// Hold one row of the A tile
+
+	for (n = 0; n < LAYOUT_TILE; n++) {
+		t0 = a[0]; t1 = a[1]; t2 = a[2]; t3 = a[3];
+		t4 = a[4]; t5 = a[5]; t6 = a[6]; t7 = a[7];
+		b[0] = t0; b[1] = t1; b[2] = t2; b[3] = t3;
+		b[4] = t4; b[5] = t5; b[6] = t6; b[7] = t7;
+		a += LAYOUT_TILE;
+		b += LAYOUT_TILE;
+	}
+	b -= LAYOUT_TILE * LAYOUT_TILE;
+
+	for (n = 0; n < LAYOUT_TILE; n++) {
+		for (m = n + 1; m < LAYOUT_TILE; m++) {
+			t0 = b[n * LAYOUT_TILE + m];
+			b[n * LAYOUT_TILE + m] = b[m * LAYOUT_TILE + n];
+			b[m * LAYOUT_TILE + n] = t0;
+		}
+	}
+}
+
+/*
+ * transpose_tiled_layout - Transposition of A and B stored in LAYOUT_TILED order
+ 					Tile (tr, tc) of A becomes tile (tc, tr) of B. A is walked in storage
+ 					order, and the padded edge tiles are transposed whole.
+ * Params: 
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Input matrix - the one transposed from, in tiled layout
+ *	B[N][M] - Input matrix - the one transposed to, in tiled layout
+ * Returns: void
+ */
+char transpose_tiled_layout_desc[] = "Tiled-layout transpose";
+void transpose_tiled_layout(int M, int N, int A[N][M], int B[M][N]){
+
+	int tile_rows = (N + LAYOUT_TILE - 1) / LAYOUT_TILE;	// Tiles down A (= across B)
+	int tile_cols = (M + LAYOUT_TILE - 1) / LAYOUT_TILE;	// Tiles across A (= down B)
+	int tr, tc;		// Tile row and column in A
+
+	for (tr = 0; tr < tile_rows; tr++) {
+		for (tc = 0; tc < tile_cols; tc++) {
+			layout_tile(&A[0][0] + (tr * tile_cols + tc) * LAYOUT_TILE * LAYOUT_TILE,
+						&B[0][0] + (tc * tile_rows + tr) * LAYOUT_TILE * LAYOUT_TILE);
+		}
+	}
+}
+
+/*
+ * transpose_morton_layout - Transposition of A and B stored in LAYOUT_MORTON order
+ 					Tile (tr, tc) sits at Z index z in A and at the index with the odd and
+ 					even bits of z swapped in B, so no coordinates need to be decoded for
+ 					tiles inside the matrix. A is walked in storage order.
+ * Params: 
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Input matrix - the one transposed from, in Morton layout
+ *	B[N][M] - Input matrix - the one transposed to, in Morton layout
+ * Returns: void
+ */
+char transpose_morton_layout_desc[] = "Morton-layout transpose";
+void transpose_morton_layout(int M, int N, int A[N][M], int B[M][N]){
+
+	int tile_rows = (N + LAYOUT_TILE - 1) / LAYOUT_TILE;	// Tiles down A
+	int tile_cols = (M + LAYOUT_TILE - 1) / LAYOUT_TILE;	// Tiles across A
+	unsigned int tiles = layoutSize(LAYOUT_MORTON, N, M) / (LAYOUT_TILE * LAYOUT_TILE);	// Z indices in use
+	unsigned int z, zt;		// Z index of a tile in A and of its transpose in B
+
+	for (z = 0; z < tiles; z++) {
+
+		// Skip the holes the Z square leaves outside a non-square matrix
+		if (morton_compact(z >> 1) >= tile_rows || morton_compact(z) >= tile_cols) {
+			continue;
+		}
+		zt = ((z >> 1) & 0x55555555) | ((z & 0x55555555) << 1);
+		layout_tile(&A[0][0] + z * LAYOUT_TILE * LAYOUT_TILE,
+					&B[0][0] + zt * LAYOUT_TILE * LAYOUT_TILE);
+	}
+}
+
+/*
+ * Block size of the graded cache (b = 5). The typed kernels below use square tiles of
+ * one line's worth of elements, so each tile row of A and tile column of B is one line.
+ */
+#define LINE_BYTES 32
+
+/*
+ * TYPED_TRANSPOSE - Define transpose_<name>, a tiled transposition of an N x M matrix of type
+ 					Tiles are LINE_BYTES / sizeof(type) on a side. As in transpose_tile, the
+ 					diagonal element of each row is written after the rest of the row, so the
+ 					A and B lines of a diagonal tile do not evict each other mid-row.
+ */
+#define TYPED_TRANSPOSE(name, type)												\
+char transpose_##name##_desc[] = "Tiled " #name " transpose";					\
+void transpose_##name(int M, int N, void *A_ptr, void *B_ptr){					\
+																				\
+	type (*A)[M] = (type (*)[M]) A_ptr;		/* Input matrix, N x M */				\
+	type (*B)[N] = (type (*)[N]) B_ptr;		/* Output matrix, M x N */				\
+	int tile = LINE_BYTES / sizeof(type);	/* Elements per line */					\
+	int n, m, row, col, diag;														\
+																				\
+	for (col = 0; col < M; col += tile) {											\
+		for (row = 0; row < N; row += tile) {										\
+			for (n = row; n < row + tile && n < N; n++) {							\
+				diag = -1;															\
+				for (m = col; m < col + tile && m < M; m++) {						\
+					if (n != m) {													\
+						B[m][n] = A[n][m];											\
+					} else {														\
+						diag = m;													\
+					}																\
+				}																	\
+				if (diag >= 0) {													\
+					B[diag][n] = A[n][diag];										\
+				}																	\
+			}																		\
+		}																			\
+	}																				\
+}
+
+TYPED_TRANSPOSE(float, float)
+TYPED_TRANSPOSE(double, double)
+TYPED_TRANSPOSE(int64, int64_t)
+TYPED_TRANSPOSE(complex, complex_t)
+
+/*
+ * TYPED_TRANSPOSE_SSE - Define transpose_<name>_sse, the SSE2 version of transpose_<name>
+ 					Same tiles, each cut into V x V blocks that are transposed in registers
+ 					by block(A, B, n, m). Rows and columns left over past the last whole
+ 					block are copied one element at a time.
+ */
+#define TYPED_TRANSPOSE_SSE(name, type, V, block)									\
+char transpose_##name##_sse_desc[] = "Tiled " #name " transpose, SSE2";			\
+void transpose_##name##_sse(int M, int N, void *A_ptr, void *B_ptr){			\
+																				\
+	type (*A)[M] = (type (*)[M]) A_ptr;		/* Input matrix, N x M */				\
+	type (*B)[N] = (type (*)[N]) B_ptr;		/* Output matrix, M x N */				\
+	int tile = LINE_BYTES / sizeof(type);	/* Elements per line */					\
+	int n, m, k, row, col;															\
+																				\
+	for (col = 0; col < M; col += tile) {											\
+		for (row = 0; row < N; row += tile) {										\
+			for (n = row; n + V <= row + tile && n + V <= N; n += V) {				\
+				for (m = col; m + V <= col + tile && m + V <= M; m += V) {			\
+					block(A, B, n, m);												\
+				}																	\
+				for (; m < col + tile && m < M; m++) {								\
+					for (k = n; k < n + V; k++) {								\
+						B[m][k] = A[k][m];											\
+					}																\
+				}																	\
+			}																		\
+			for (; n < row + tile && n < N; n++) {									\
+				for (m = col; m < col + tile && m < M; m++) {						\
+					B[m][n] = A[n][m];												\
+				}																	\
+			}																		\
+		}																			\
+	}																				\
+}
+
+/* float_block - Transpose a 4 x 4 block of floats in four registers */
+#define float_block(A, B, n, m) do {												\
+	__m128 r0 = _mm_loadu_ps(&A[n][m]), r1 = _mm_loadu_ps(&A[n + 1][m]);		\
+	__m128 r2 = _mm_loadu_ps(&A[n + 2][m]), r3 = _mm_loadu_ps(&A[n + 3][m]);	\
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);												\
+	_mm_storeu_ps(&B[m][n], r0); _mm_storeu_ps(&B[m + 1][n], r1);				\
+	_mm_storeu_ps(&B[m + 2][n], r2); _mm_storeu_ps(&B[m + 3][n], r3);			\
+} while (0)
+
+/* double_block - Transpose a 2 x 2 block of doubles in two registers */
+#define double_block(A, B, n, m) do {												\
+	__m128d r0 = _mm_loadu_pd(&A[n][m]), r1 = _mm_loadu_pd(&A[n + 1][m]);		\
+	_mm_storeu_pd(&B[m][n], _mm_unpacklo_pd(r0, r1));								\
+	_mm_storeu_pd(&B[m + 1][n], _mm_unpackhi_pd(r0, r1));							\
+} while (0)
+
+/* int64_block - Transpose a 2 x 2 block of 64-bit integers in two registers */
+#define int64_block(A, B, n, m) do {												\
+	__m128i r0 = _mm_loadu_si128((__m128i *) &A[n][m]);							\
+	__m128i r1 = _mm_loadu_si128((__m128i *) &A[n + 1][m]);						\
+	_mm_storeu_si128((__m128i *) &B[m][n], _mm_unpacklo_epi64(r0, r1));			\
+	_mm_storeu_si128((__m128i *) &B[m + 1][n], _mm_unpackhi_epi64(r0, r1));		\
+} while (0)
+
+/* complex_block - Move one 16-byte complex element as a single register */
+#define complex_block(A, B, n, m)													\
+	_mm_storeu_si128((__m128i *) &B[m][n], _mm_loadu_si128((__m128i *) &A[n][m]))
+
+TYPED_TRANSPOSE_SSE(float, float, 4, float_block)
+TYPED_TRANSPOSE_SSE(double, double, 2, double_block)
+TYPED_TRANSPOSE_SSE(int64, int64_t, 2, int64_block)
+TYPED_TRANSPOSE_SSE(complex, complex_t, 1, complex_block)
+
+/*
+ * transpose_inplace_cycle - In-place transposition of any N x M matrix by cycle following
+ 					Element k of the row-major buffer moves to (k * N) mod (M*N - 1). Each
+ 					permutation cycle is rotated once, from its smallest index (its leader),
+ 					so no extra memory is needed. Finding leaders touches no matrix memory.
+ * Params: 
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Matrix to transpose - holds A^T as an M x N matrix on return
+ * Returns: void
+ */
+char transpose_inplace_cycle_desc[] = "In-place cycle-following transpose";
+void transpose_inplace_cycle(int M, int N, int A[N][M]){
+
+	int *a = &A[0][0];		// Row-major view of the matrix
+	long last = (long) M * N - 1;	// First and last elements never move
+	long start, cur;		// Cycle leader candidate and position within its cycle
+	int val, tmp;			// Element being carried around the cycle
+
+	for (start = 1; start < last; start++) {
+
+		// Only rotate the cycle from its smallest index
+		for (cur = (start * N) % last; cur > start; cur = (cur * N) % last);
+		if (cur != start) {
+			continue;
+		}
+
+		// Carry each element to its destination, picking up the one it displaces
+		val = a[start];
+		do {
+			cur = (cur * N) % last;
+			tmp = a[cur];
+			a[cur] = val;
+			val = tmp;
+		} while (cur != start);
+	}
+}
+
+/*
+ * transpose_inplace_square - In-place transposition of a square matrix
+ 					Walks the 8x8 tiles above the diagonal row by row and swaps each one
+ 					with its mirror tile below the diagonal, so both tiles stay resident
+ 					while they are exchanged. Rectangular shapes fall back to cycle following.
+ * Params: 
+ *	M - Number of columns in the matrix
+ *	N -	Number of rows in the matrix
+ *	A[N][M] - Matrix to transpose - holds A^T on return
+ * Returns: void
+ */
+char transpose_inplace_square_desc[] = "In-place tiled square transpose";
+void transpose_inplace_square(int M, int N, int A[N][M]){
+
+	int n, m; 		// Indecies for rows and columns in matrix
+	int row, col;	// Track current tile row and column in matrix
+	int tmp;		// Hold element being swapped across the diagonal
+
+	if (M != N) {
+		transpose_inplace_cycle(M, N, A);
+		return;
+	}
+
+	for (row = 0; row < N; row += 8) {
+		for (col = row; col < N; col += 8) {
+
+			// Swap tile (row, col) with the transpose of tile (col, row);
+			// on a diagonal tile only the part above the diagonal is visited
+			for (n = row; (n < row + 8) && (n < N); n++) {
+				for (m = (col == row) ? n + 1 : col; (m < col + 8) && (m < N); m++) {
+					tmp = A[n][m];
+					A[n][m] = A[m][n];
+					A[m][n] = tmp;
+				}
+			}
+		}
+	}
+}
+
 /* 
  * trans - A simple baseline transpose function, not optimized for the cache.
  */
@@ -227,6 +723,27 @@ void registerFunctions()
     registerTransFunction(transpose_32, transpose_32_desc);
     registerTransFunction(transpose_64, transpose_64_desc);
     registerTransFunction(transpose_other, transpose_other_desc);
+    registerTransFunction(transpose_oblivious, transpose_oblivious_desc);
+    registerTransFunction(transpose_morton, transpose_morton_desc);
+    registerTransFunction(transpose_panels, transpose_panels_desc);
+
+    // Register transpose functions that take A and B in a tiled storage layout
+    registerLayoutTransFunction(transpose_tiled_layout, transpose_tiled_layout_desc, LAYOUT_TILED);
+    registerLayoutTransFunction(transpose_morton_layout, transpose_morton_layout_desc, LAYOUT_MORTON);
+
+    // Register in-place transpose functions
+    registerInPlaceTransFunction(transpose_inplace_square, transpose_inplace_square_desc);
+    registerInPlaceTransFunction(transpose_inplace_cycle, transpose_inplace_cycle_desc);
+
+    // Register transpose functions for other element types, scalar then SSE2
+    registerTypedTransFunction(transpose_float, transpose_float_desc, sizeof(float));
+    registerTypedTransFunction(transpose_double, transpose_double_desc, sizeof(double));
+    registerTypedTransFunction(transpose_int64, transpose_int64_desc, sizeof(int64_t));
+    registerTypedTransFunction(transpose_complex, transpose_complex_desc, sizeof(complex_t));
+    registerTypedTransFunction(transpose_float_sse, transpose_float_sse_desc, sizeof(float));
+    registerTypedTransFunction(transpose_double_sse, transpose_double_sse_desc, sizeof(double));
+    registerTypedTransFunction(transpose_int64_sse, transpose_int64_sse_desc, sizeof(int64_t));
+    registerTypedTransFunction(transpose_complex_sse, transpose_complex_sse_desc, sizeof(complex_t));
 
 }
 